@@ -0,0 +1,412 @@
+// gen_testfile.c
+// 多线程生成测试文件，用来代替 notebook 里的 Python 生成脚本。
+// 编译: gcc -O2 -pthread -o target/gen_testfile gen_testfile.c
+//
+// 输出被切成固定大小的块，每个块的 PRNG 种子只由 (seed, 文件序号, 块序号) 决定，
+// 所以无论用多少个线程，同一个 seed 生成的文件内容都完全相同。
+// 各线程用 pwrite 写入互不重叠的偏移，不需要任何锁。
+#define _GNU_SOURCE // fallocate
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#define CHUNK_SIZE (4 * 1024 * 1024) // unit of work and of seeding
+#define XO_LANES 4                   // independent xoshiro streams, one AVX2 register wide
+#define DEFAULT_SIZE (2ULL * 1024 * 1024 * 1024)
+#define DEFAULT_SEED 42
+#define MAX_THREADS 1024
+#define MAX_FILES 65536
+
+enum gen_mode
+{
+    MODE_RANDOM, // raw random bytes, like the original script
+    MODE_TEXT,   // printable words, spaces and occasional newlines
+    MODE_LINES   // lines of 16..143 printable characters, shorter where a chunk ends
+};
+
+struct gen_config
+{
+    uint64_t size; // bytes per file
+    uint64_t seed;
+    enum gen_mode mode;
+    int threads;
+    int files;
+    uint64_t sparse; // 0: dense; N: only every N-th chunk holds data
+    int *fds;
+    uint64_t chunks_per_file;
+    atomic_uint_fast64_t next_job;
+};
+
+// 64 entries so a byte maps with "& 63"; letter frequencies roughly follow English.
+static const char text_table[64] = "abcdefghijklmnopqrstuvwxyzetaoinshrdlucmfwTAISWHOB0123,.       \n";
+// Same alphabet without the newline, for MODE_LINES which places newlines itself.
+static const char line_table[64] = "abcdefghijklmnopqrstuvwxyzetaoinshrdlucmfwTAISWHOB0123,.        ";
+
+// xoshiro256++, XO_LANES streams interleaved so the update vectorises.
+struct xoshiro4
+{
+    uint64_t s[4][XO_LANES];
+};
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t splitmix64(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static void xoshiro4_seed(struct xoshiro4 *x, uint64_t seed, uint64_t file, uint64_t chunk)
+{
+    uint64_t sm = seed;
+    sm ^= splitmix64(&sm) + file;
+    sm ^= splitmix64(&sm) + chunk;
+    for (int k = 0; k < 4; k++)
+        for (int lane = 0; lane < XO_LANES; lane++)
+            x->s[k][lane] = splitmix64(&sm);
+}
+
+static inline void xoshiro4_next(struct xoshiro4 *x, uint64_t out[XO_LANES])
+{
+    for (int lane = 0; lane < XO_LANES; lane++)
+    {
+        out[lane] = rotl(x->s[0][lane] + x->s[3][lane], 23) + x->s[0][lane];
+        uint64_t t = x->s[1][lane] << 17;
+        x->s[2][lane] ^= x->s[0][lane];
+        x->s[3][lane] ^= x->s[1][lane];
+        x->s[1][lane] ^= x->s[2][lane];
+        x->s[0][lane] ^= x->s[3][lane];
+        x->s[2][lane] ^= t;
+        x->s[3][lane] = rotl(x->s[3][lane], 45);
+    }
+}
+
+// Fills the first len bytes of one chunk; len is CHUNK_SIZE except for the
+// file's last chunk. Random bytes are drawn in xoshiro4 output widths (which
+// divide CHUNK_SIZE), so a chunk's prefix is the same whatever len is.
+static void fill_chunk(unsigned char *buf, size_t len, enum gen_mode mode, struct xoshiro4 *rng)
+{
+    uint64_t out[XO_LANES];
+    for (size_t i = 0; i < len; i += sizeof(out))
+    {
+        xoshiro4_next(rng, out);
+        memcpy(buf + i, out, sizeof(out));
+    }
+
+    if (mode == MODE_TEXT)
+    {
+        for (size_t i = 0; i < len; i++)
+            buf[i] = (unsigned char)text_table[buf[i] & 63];
+    }
+    else if (mode == MODE_LINES)
+    {
+        // The random byte at the start of each line also picks its length.
+        // Chunks are seeded independently, so each one ends its last line
+        // itself instead of letting it run into the next chunk's first line
+        // (or, for the last chunk, leaving the file without a final newline).
+        size_t pos = 0;
+        while (pos < len - 1)
+        {
+            size_t line_len = 16 + (buf[pos] & 127);
+            size_t end = pos + line_len < len - 1 ? pos + line_len : len - 1;
+            for (size_t i = pos; i < end; i++)
+                buf[i] = (unsigned char)line_table[buf[i] & 63];
+            buf[end] = '\n';
+            pos = end + 1;
+        }
+        buf[len - 1] = '\n';
+    }
+}
+
+static int pwrite_all(int fd, const unsigned char *buf, size_t len, off_t offset)
+{
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, buf, len, offset);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static void *gen_worker(void *arg)
+{
+    struct gen_config *cfg = arg;
+    unsigned char *buf;
+    if (posix_memalign((void **)&buf, (size_t)sysconf(_SC_PAGESIZE), CHUNK_SIZE) != 0)
+    {
+        fprintf(stderr, "posix_memalign failed in gen_worker\n");
+        return (void *)1;
+    }
+
+    uint64_t total_jobs = cfg->chunks_per_file * (uint64_t)cfg->files;
+    void *ret = NULL;
+    for (;;)
+    {
+        uint64_t job = atomic_fetch_add(&cfg->next_job, 1);
+        if (job >= total_jobs)
+            break;
+        uint64_t file = job / cfg->chunks_per_file;
+        uint64_t chunk = job % cfg->chunks_per_file;
+        if (cfg->sparse && chunk % cfg->sparse != 0)
+            continue; // left as a hole
+
+        uint64_t offset = chunk * CHUNK_SIZE;
+        size_t len = cfg->size - offset < CHUNK_SIZE ? (size_t)(cfg->size - offset) : CHUNK_SIZE;
+        struct xoshiro4 rng;
+        xoshiro4_seed(&rng, cfg->seed, file, chunk);
+        fill_chunk(buf, len, cfg->mode, &rng);
+        if (pwrite_all(cfg->fds[file], buf, len, (off_t)offset) == -1)
+        {
+            perror("Error writing output file");
+            ret = (void *)1;
+            break;
+        }
+    }
+
+    free(buf);
+    return ret;
+}
+
+// Parses "123", "64K", "256M", "2G", "1T".
+static int parse_size(const char *arg, uint64_t *size)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 10);
+    int shift = 0;
+    switch (*end)
+    {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    case 'T': case 't': shift = 40; end++; break;
+    }
+    if (errno != 0 || *end != '\0' || end == arg || *arg == '-' || value > (UINT64_MAX >> shift))
+        return -1;
+    *size = (uint64_t)value << shift;
+    return 0;
+}
+
+// Plain number within [min, max], for the count options.
+static int parse_number(const char *arg, int base, uint64_t min, uint64_t max, uint64_t *out)
+{
+    char *end;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, base);
+    if (errno != 0 || *end != '\0' || end == arg || *arg == '-' || value < min || value > max)
+        return -1;
+    *out = value;
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <output>\n"
+            "  -s, --size SIZE     bytes per file, K/M/G/T suffixes allowed (default 2G)\n"
+            "  -S, --seed N        PRNG seed (default %d); same seed, same bytes\n"
+            "  -m, --mode MODE     random | text | lines (default random)\n"
+            "  -j, --threads N     worker threads (default: online CPUs)\n"
+            "  -n, --files N       write <output>.0 .. <output>.N-1 instead of one file\n"
+            "      --sparse N      only every N-th %d MiB chunk holds data, the rest are holes\n",
+            prog, DEFAULT_SEED, CHUNK_SIZE >> 20);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option long_options[] = {
+        {"size", required_argument, NULL, 's'},
+        {"seed", required_argument, NULL, 'S'},
+        {"mode", required_argument, NULL, 'm'},
+        {"threads", required_argument, NULL, 'j'},
+        {"files", required_argument, NULL, 'n'},
+        {"sparse", required_argument, NULL, 'p'},
+        {NULL, 0, NULL, 0},
+    };
+
+    struct gen_config cfg = {
+        .size = DEFAULT_SIZE,
+        .seed = DEFAULT_SEED,
+        .mode = MODE_RANDOM,
+        .threads = (int)sysconf(_SC_NPROCESSORS_ONLN),
+        .files = 1,
+    };
+
+    int opt;
+    uint64_t value;
+    while ((opt = getopt_long(argc, argv, "s:S:m:j:n:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            if (parse_size(optarg, &cfg.size) == -1)
+            {
+                fprintf(stderr, "Invalid size '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'S':
+            if (parse_number(optarg, 0, 0, UINT64_MAX, &cfg.seed) == -1)
+            {
+                fprintf(stderr, "Invalid seed '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'm':
+            if (strcmp(optarg, "random") == 0)
+                cfg.mode = MODE_RANDOM;
+            else if (strcmp(optarg, "text") == 0)
+                cfg.mode = MODE_TEXT;
+            else if (strcmp(optarg, "lines") == 0)
+                cfg.mode = MODE_LINES;
+            else
+            {
+                fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'j':
+            if (parse_number(optarg, 10, 1, MAX_THREADS, &value) == -1)
+            {
+                fprintf(stderr, "Invalid thread count '%s' (1..%d)\n", optarg, MAX_THREADS);
+                exit(EXIT_FAILURE);
+            }
+            cfg.threads = (int)value;
+            break;
+        case 'n':
+            if (parse_number(optarg, 10, 1, MAX_FILES, &value) == -1)
+            {
+                fprintf(stderr, "Invalid file count '%s' (1..%d)\n", optarg, MAX_FILES);
+                exit(EXIT_FAILURE);
+            }
+            cfg.files = (int)value;
+            break;
+        case 'p':
+            if (parse_number(optarg, 10, 0, UINT64_MAX, &cfg.sparse) == -1)
+            {
+                fprintf(stderr, "Invalid sparse interval '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc - 1 || cfg.files < 1)
+    {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (cfg.threads < 1)
+        cfg.threads = 1;
+
+    const char *output = argv[optind];
+    cfg.chunks_per_file = (cfg.size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    cfg.fds = calloc((size_t)cfg.files, sizeof(int));
+    if (cfg.fds == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < cfg.files; i++)
+    {
+        char name[4096];
+        if (cfg.files == 1)
+            snprintf(name, sizeof(name), "%s", output);
+        else
+            snprintf(name, sizeof(name), "%s.%d", output, i);
+
+        cfg.fds[i] = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (cfg.fds[i] == -1)
+        {
+            fprintf(stderr, "Error opening output file %s: %s\n", name, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        // Reserve the extents up front so concurrent pwrites do not fragment
+        // the file. A sparse corpus must keep its holes, so it is only sized.
+        if (cfg.sparse || cfg.size == 0 || fallocate(cfg.fds[i], 0, 0, (off_t)cfg.size) == -1)
+        {
+            if (!cfg.sparse && cfg.size != 0)
+                fprintf(stderr, "Warning: fallocate failed on %s: %s\n", name, strerror(errno));
+            if (ftruncate(cfg.fds[i], (off_t)cfg.size) == -1)
+            {
+                fprintf(stderr, "Error sizing output file %s: %s\n", name, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    pthread_t *threads = calloc((size_t)cfg.threads, sizeof(pthread_t));
+    if (threads == NULL)
+    {
+        perror("calloc failed");
+        exit(EXIT_FAILURE);
+    }
+    atomic_init(&cfg.next_job, 0);
+
+    int started = 0;
+    for (; started < cfg.threads; started++)
+    {
+        if (pthread_create(&threads[started], NULL, gen_worker, &cfg) != 0)
+        {
+            fprintf(stderr, "Warning: only %d worker threads could be started\n", started);
+            break;
+        }
+    }
+    int failed = 0;
+    if (started == 0 && gen_worker(&cfg) != NULL)
+        failed = 1;
+    for (int i = 0; i < started; i++)
+    {
+        void *ret;
+        pthread_join(threads[i], &ret);
+        if (ret != NULL)
+            failed = 1;
+    }
+    free(threads);
+
+    for (int i = 0; i < cfg.files; i++)
+    {
+        if (close(cfg.fds[i]) == -1)
+        {
+            perror("Error closing output file");
+            failed = 1;
+        }
+    }
+    free(cfg.fds);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    double bytes = (double)cfg.size * cfg.files;
+    fprintf(stderr, "Generated %.0f bytes in %.3f s (%.2f GB/s) with %d threads\n", bytes, seconds,
+            seconds > 0 ? bytes / seconds / (1024.0 * 1024 * 1024) : 0.0, started ? started : 1);
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,9 +1,10 @@
+// 编译: gcc -O2 -o target/mycat3 mycat3.c mycat_copy.c
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
-#include <stdint.h> // For uintptr_t
+#include "mycat_copy.h"
 
 // 函数：获取页大小 (同 mycat2)
 long io_blocksize()
@@ -18,54 +19,6 @@ long io_blocksize()
     return page_size;
 }
 
-// 分配对齐的内存
-void *align_alloc(size_t size, size_t alignment)
-{
-    if (alignment == 0)
-        alignment = 1; // Avoid division by zero if alignment is bad
-                       // Ensure alignment is a power of two
-    if ((alignment & (alignment - 1)) != 0)
-    {
-        fprintf(stderr, "Alignment must be a power of two.\n");
-        return NULL;
-    }
-
-    void *original_ptr = NULL;
-    // We need to store the original pointer right before the aligned pointer.
-    // So, we allocate 'size' + 'alignment - 1' (for finding the aligned spot)
-    // + 'sizeof(void*)' (to store the original pointer).
-    size_t total_size = size + alignment - 1 + sizeof(void *);
-    original_ptr = malloc(total_size);
-
-    if (original_ptr == NULL)
-    {
-        return NULL;
-    }
-
-    // Calculate the aligned pointer.
-    // Add sizeof(void*) to leave space for storing the original_ptr.
-    // Then align this new address.
-    uintptr_t aligned_addr_val = ((uintptr_t)original_ptr + sizeof(void *) + alignment - 1) & ~(alignment - 1);
-    void *aligned_ptr = (void *)aligned_addr_val;
-
-    // Store the original pointer just before the aligned block.
-    *((void **)((uintptr_t)aligned_ptr - sizeof(void *))) = original_ptr;
-
-    return aligned_ptr;
-}
-
-// 释放对齐的内存
-void align_free(void *ptr)
-{
-    if (ptr == NULL)
-    {
-        return;
-    }
-    // Retrieve the original pointer stored just before the aligned block.
-    void *original_ptr = *((void **)((uintptr_t)ptr - sizeof(void *)));
-    free(original_ptr);
-}
-
 int main(int argc, char *argv[])
 {
     if (argc != 2)
@@ -1,10 +1,11 @@
+// 编译: gcc -O2 -o target/mycat4 mycat4.c mycat_copy.c
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>   // read, write, close, sysconf, STDIN_FILENO, STDOUT_FILENO
 #include <fcntl.h>    // open, O_RDONLY
 #include <errno.h>    // errno
-#include <stdint.h>   // For uintptr_t
 #include <sys/stat.h> // For fstat, struct stat
+#include "mycat_copy.h"
 
 // 函数：决定IO操作的块大小（缓冲区大小）
 // 综合考虑页大小和文件系统块大小
@@ -54,40 +55,6 @@ long io_blocksize(int fd)
     return chosen_buffer_size;
 }
 
-// 分配对齐的内存 (与 mycat3 相同)
-void *align_alloc(size_t size, size_t alignment)
-{
-    if (alignment == 0)
-        alignment = 1;
-    if ((alignment & (alignment - 1)) != 0 && alignment != 1)
-    {
-        fprintf(stderr, "Alignment for align_alloc must be a power of two.\n");
-        return NULL;
-    }
-    void *original_ptr = NULL;
-    size_t total_size = size + alignment - 1 + sizeof(void *);
-    original_ptr = malloc(total_size);
-    if (original_ptr == NULL)
-    {
-        return NULL;
-    }
-    uintptr_t aligned_addr_val = ((uintptr_t)original_ptr + sizeof(void *) + alignment - 1) & ~(alignment - 1);
-    void *aligned_ptr = (void *)aligned_addr_val;
-    *((void **)((uintptr_t)aligned_ptr - sizeof(void *))) = original_ptr;
-    return aligned_ptr;
-}
-
-// 释放对齐的内存 (与 mycat3 相同)
-void align_free(void *ptr)
-{
-    if (ptr == NULL)
-    {
-        return;
-    }
-    void *original_ptr = *((void **)((uintptr_t)ptr - sizeof(void *)));
-    free(original_ptr);
-}
-
 int main(int argc, char *argv[])
 {
     if (argc != 2)
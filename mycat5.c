@@ -1,16 +1,13 @@
 // mycat5.c
+// 编译: gcc -O2 -o target/mycat5 mycat5.c mycat_copy.c
 #define _GNU_SOURCE // For posix_fadvise if used in later versions, not strictly needed here but good for fcntl.h
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>   // read, write, close, sysconf, STDIN_FILENO, STDOUT_FILENO
 #include <fcntl.h>    // open, O_RDONLY
 #include <errno.h>    // errno
-#include <stdint.h>   // For uintptr_t
 #include <sys/stat.h> // For fstat, struct stat
-
-// This is the "optimal" buffer size determined from experiments (e.g., dd tests)
-// or a common well-performing size like 128KB used by GNU cat.
-#define OPTIMAL_BUFFER_SIZE (256 * 1024) // 128 KB
+#include "mycat_copy.h" // align_alloc, and OPTIMAL_BUFFER_SIZE (256 KB) from the dd experiments
 
 // 函数：决定IO操作的块大小（缓冲区大小）
 // 在这个版本中，我们直接使用一个实验确定的“最优”大小，
@@ -74,57 +71,6 @@ long determine_io_blocksize(int fd)
     return OPTIMAL_BUFFER_SIZE; // Directly use the experimentally derived optimal size
 }
 
-// 分配对齐的内存 (与 mycat3/4 相同)
-void *align_alloc(size_t size, size_t alignment)
-{
-    if (alignment == 0)
-        alignment = 1; // Should not happen with page_size
-    // Ensure alignment is a power of two, which page_size should be
-    if ((alignment & (alignment - 1)) != 0 && alignment != 1)
-    {
-        // This case should ideally not be hit if alignment is sysconf(_SC_PAGESIZE)
-        fprintf(stderr, "Warning: Alignment %zu is not a power of two. Using default alignment 1.\n", alignment);
-        alignment = sysconf(_SC_PAGESIZE); // Fallback to page size if invalid
-        if (alignment <= 0 || (alignment & (alignment - 1)) != 0)
-            alignment = 4096; // Further fallback
-    }
-
-    void *original_ptr;
-    // We need space for the original pointer + the requested size + potential alignment padding
-    size_t total_size = size + alignment - 1 + sizeof(void *);
-    original_ptr = malloc(total_size);
-
-    if (original_ptr == NULL)
-    {
-        perror("malloc failed in align_alloc");
-        return NULL;
-    }
-
-    // Calculate the aligned pointer
-    // 1. Add sizeof(void*) to leave space to store the original_ptr
-    // 2. Add (alignment - 1) for the rounding trick
-    // 3. Mask with ~(alignment - 1) to round down to the nearest alignment boundary
-    uintptr_t aligned_addr_val = ((uintptr_t)original_ptr + sizeof(void *) + alignment - 1) & ~(alignment - 1);
-    void *aligned_ptr = (void *)aligned_addr_val;
-
-    // Store the original pointer just before the aligned block
-    *((void **)((uintptr_t)aligned_ptr - sizeof(void *))) = original_ptr;
-
-    return aligned_ptr;
-}
-
-// 释放对齐的内存 (与 mycat3/4 相同)
-void align_free(void *ptr)
-{
-    if (ptr == NULL)
-    {
-        return;
-    }
-    // Retrieve the original pointer stored just before the aligned block
-    void *original_ptr = *((void **)((uintptr_t)ptr - sizeof(void *)));
-    free(original_ptr);
-}
-
 int main(int argc, char *argv[])
 {
     if (argc != 2)
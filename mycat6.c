@@ -1,4 +1,5 @@
 // mycat6.c
+// 编译: gcc -O2 -pthread -o target/mycat6 mycat6.c mycat_nl.c mycat_lineidx.c mycat_affinity.c mycat_copy.c
 #define _GNU_SOURCE // For posix_fadvise
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,80 +9,592 @@
 #include <stdint.h>
 #include <sys/stat.h>
 #include <string.h> // <--- 添加这一行以声明 strerror
-#define OPTIMAL_BUFFER_SIZE (256 * 1024)
+#include <getopt.h>
+#include <sys/inotify.h>
+#include <pthread.h>
+#include <time.h>
+#include "mycat_nl.h"
+#include "mycat_lineidx.h"
+#include "mycat_affinity.h"
+#include "mycat_copy.h"
+#define RING_SLOTS 4 // buffers in flight between the --threaded reader and writer
+#define FOLLOW_POLL_MS 100 // only used when inotify is unavailable
 
-long determine_io_blocksize_mycat6(int fd)
+// Copies [offset, offset + len) of fd_in to stdout with whatever engine
+// mycat_copy picks for stdout (splice into a pipe, sendfile elsewhere).
+static int emit_range(int fd_in, uint64_t offset, uint64_t len, char *buf, size_t bufsize)
 {
-    // Same logic as mycat5, can be simplified to just return OPTIMAL_BUFFER_SIZE
-    // or retain the fs_blk_size check if desired.
-    // For this task, fadvise is the key change, buffer size logic can be identical to mycat5.
-    long page_size = sysconf(_SC_PAGESIZE);
-    if (page_size == -1)
-        page_size = 4096;
+    if (len == 0)
+        return 0;
+    if (lseek(fd_in, (off_t)offset, SEEK_SET) == -1)
+    {
+        perror("lseek on input file failed");
+        return -1;
+    }
+    struct copy_options opts = {.bufsize = bufsize, .buf = buf, .limit = len};
+    return mycat_copy(fd_in, STDOUT_FILENO, &opts, NULL);
+}
+
+// Moves *pos forward past `lines` newlines.
+// Returns 0 when they were all found, 1 when EOF came first (*pos is then EOF), -1 on error.
+static int skip_lines(int fd_in, uint64_t *pos, uint64_t lines, char *buf, size_t bufsize)
+{
+    size_t left = (size_t)lines;
+    while (left > 0)
+    {
+        ssize_t n = pread(fd_in, buf, bufsize, (off_t)*pos);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading from input file");
+            return -1;
+        }
+        if (n == 0)
+            return 1;
+        ssize_t found = nl_find_nth(buf, (size_t)n, &left);
+        *pos += (uint64_t)(found == -1 ? n : found);
+    }
+    return 0;
+}
 
-    struct stat file_stat;
-    blksize_t fs_blk_size = 0;
+// --lines A,B: start from the nearest indexed offset instead of byte 0.
+static int serve_lines(int fd_in, const char *path, uint64_t first, uint64_t last, char *buf, size_t bufsize)
+{
+    uint64_t start = 0;
+    uint64_t skip = first - 1;
+
+    struct stat st;
+    char *idx_path = lineidx_path(path);
+    struct lineidx idx;
+    if (idx_path != NULL && fstat(fd_in, &st) == 0 && lineidx_open(&idx, idx_path) == 0)
+    {
+        enum lineidx_state state = lineidx_check(&idx, fd_in, &st);
+        if (state == LINEIDX_GROWN)
+        {
+            // Only the appended bytes are scanned; persisting the result is best effort.
+            if (lineidx_extend(&idx, fd_in, buf, bufsize) == 0)
+                lineidx_save(&idx, idx_path, fd_in);
+            else
+                state = LINEIDX_STALE;
+        }
+        if (state != LINEIDX_STALE)
+            lineidx_seek_line(&idx, first, &start, &skip);
+        else
+            unlink(idx_path); // a later append must not make it look GROWN again
+        lineidx_free(&idx);
+    }
+    free(idx_path);
+
+    int ret = skip_lines(fd_in, &start, skip, buf, bufsize);
+    if (ret != 0)
+        return ret == 1 ? 0 : -1; // fewer than `first` lines: nothing to print
 
-    if (fstat(fd, &file_stat) == 0)
+    uint64_t end = start;
+    if (skip_lines(fd_in, &end, last - first + 1, buf, bufsize) == -1)
+        return -1;
+    return emit_range(fd_in, start, end - start, buf, bufsize);
+}
+
+// pread until len bytes are in buf. Returns -1 on error or early EOF.
+static int pread_full(int fd, char *buf, size_t len, uint64_t offset)
+{
+    while (len > 0)
     {
-        fs_blk_size = file_stat.st_blksize;
-        if (fs_blk_size <= 0 || (fs_blk_size & (fs_blk_size - 1)) != 0)
-        {                    // Not positive or not power of 2
-            fs_blk_size = 0; // Treat as invalid for comparison
+        ssize_t n = pread(fd, buf, len, (off_t)offset);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading from input file");
+            return -1;
+        }
+        if (n == 0)
+        {
+            fprintf(stderr, "Error: input file shrank while reading it\n");
+            return -1;
         }
+        buf += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+// --tail N: walk back from EOF in bufsize-aligned blocks until N newlines are
+// seen, then send the whole tail in one range. Only the tail is ever read, so
+// the cost does not depend on the file size. *end is set to the size printed up to.
+static int tail_lines(int fd_in, uint64_t lines, uint64_t *end, char *buf, size_t bufsize)
+{
+    struct stat st;
+    if (fstat(fd_in, &st) == -1)
+    {
+        perror("fstat failed");
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "Error: --tail needs a regular (seekable) file\n");
+        return -1;
     }
 
-    long chosen_buffer_size = OPTIMAL_BUFFER_SIZE;
-    if (fs_blk_size > 0 && (long)fs_blk_size > chosen_buffer_size)
+    uint64_t size = (uint64_t)st.st_size;
+    uint64_t start = lines == 0 ? size : 0;
+    size_t wanted = (size_t)lines;
+
+    // The last byte never starts a line: a trailing '\n' only ends the last one.
+    uint64_t pos = size > 0 ? size - 1 : 0;
+    while (wanted > 0 && pos > 0)
     {
-        chosen_buffer_size = (long)fs_blk_size;
+        uint64_t block_start = (pos - 1) / bufsize * bufsize;
+        size_t len = (size_t)(pos - block_start);
+        if (pread_full(fd_in, buf, len, block_start) == -1)
+            return -1;
+        ssize_t hit = nl_rfind_nth(buf, len, &wanted);
+        if (hit != -1)
+        {
+            start = block_start + (uint64_t)hit + 1;
+            break;
+        }
+        pos = block_start;
     }
-    // printf("Debug mycat6: Buffer size: %ld\n", chosen_buffer_size);
-    return chosen_buffer_size;
+
+    *end = size;
+    return emit_range(fd_in, start, size - start, buf, bufsize);
 }
 
-// align_alloc and align_free are identical to mycat5
-void *align_alloc(size_t size, size_t alignment)
+// --follow: print whatever gets appended after `pos`. inotify wakes us on each
+// write; polling is only a fallback when no watch can be set up.
+static int follow_file(int fd_in, const char *path, uint64_t pos, char *buf, size_t bufsize)
 {
-    if (alignment == 0)
-        alignment = 1;
-    if ((alignment & (alignment - 1)) != 0 && alignment != 1)
+    int ifd = inotify_init1(IN_CLOEXEC);
+    int wd = -1;
+    if (ifd != -1)
+        wd = inotify_add_watch(ifd, path, IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (wd == -1)
+        fprintf(stderr, "Warning: inotify unavailable (%s), polling every %d ms\n", strerror(errno), FOLLOW_POLL_MS);
+
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int ret = 0;
+    for (;;)
     {
-        alignment = sysconf(_SC_PAGESIZE);
-        if (alignment <= 0 || (alignment & (alignment - 1)) != 0)
-            alignment = 4096;
+        // Checked after the watch exists, so no write between the two is lost.
+        struct stat st;
+        if (fstat(fd_in, &st) == -1)
+        {
+            perror("fstat failed");
+            ret = -1;
+            break;
+        }
+        if ((uint64_t)st.st_size < pos)
+        {
+            fprintf(stderr, "%s: file truncated\n", path);
+            pos = 0;
+        }
+        if ((uint64_t)st.st_size > pos)
+        {
+            if (emit_range(fd_in, pos, (uint64_t)st.st_size - pos, buf, bufsize) == -1)
+            {
+                ret = -1;
+                break;
+            }
+            pos = (uint64_t)st.st_size;
+        }
+
+        if (wd == -1)
+        {
+            usleep(FOLLOW_POLL_MS * 1000);
+            continue;
+        }
+
+        ssize_t n = read(ifd, events, sizeof(events));
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading inotify events");
+            ret = -1;
+            break;
+        }
+        int watch_gone = 0;
+        for (char *p = events; p < events + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len)
+        {
+            if (((struct inotify_event *)p)->mask & IN_IGNORED)
+                watch_gone = 1;
+        }
+        if (watch_gone)
+            break; // file deleted and released: nothing more can be appended
     }
-    void *original_ptr;
-    size_t total_size = size + alignment - 1 + sizeof(void *);
-    original_ptr = malloc(total_size);
-    if (original_ptr == NULL)
+
+    if (ifd != -1)
+        close(ifd);
+    return ret;
+}
+
+// State of the plain copy to stdout (default mode and --threaded).
+struct copy_job
+{
+    int fd_in;
+    size_t bufsize;
+    struct lineidx *idx; // --index; dropped if it runs out of memory
+    struct placement *pl;
+    int explain;
+    int dry_run;
+    uint64_t copied;
+    int threaded;            // the --threaded reader thread actually ran
+    enum copy_engine engine; // what copy_single ended up using
+};
+
+static void copy_index_chunk(void *ctx, const char *buf, size_t len)
+{
+    struct copy_job *job = ctx;
+    if (job->idx != NULL && lineidx_feed(job->idx, buf, len) == -1)
     {
-        perror("malloc failed in align_alloc");
-        return NULL;
+        lineidx_free(job->idx);
+        job->idx = NULL;
     }
-    uintptr_t aligned_addr_val = ((uintptr_t)original_ptr + sizeof(void *) + alignment - 1) & ~(alignment - 1);
-    void *aligned_ptr = (void *)aligned_addr_val;
-    *((void **)((uintptr_t)aligned_ptr - sizeof(void *))) = original_ptr;
-    return aligned_ptr;
 }
 
-void align_free(void *ptr)
+// Default mode: mycat_copy picks the engine from the input and stdout types.
+static int copy_single(struct copy_job *job, char *buf)
+{
+    placement_pin_reader(job->pl); // one thread does both sides
+
+    struct copy_options opts = {
+        .bufsize = job->bufsize,
+        .buf = buf,
+        .explain = job->explain,
+        .dry_run = job->dry_run,
+        .on_chunk = job->idx != NULL ? copy_index_chunk : NULL,
+        .on_chunk_ctx = job,
+    };
+    struct copy_stats stats = {.engine = COPY_ENGINE_READ_WRITE};
+    int ret = mycat_copy(job->fd_in, STDOUT_FILENO, &opts, &stats);
+    job->copied = stats.bytes;
+    job->engine = stats.engine;
+    return ret;
+}
+
+// --threaded: a reader thread fills RING_SLOTS buffers while the main thread
+// writes them out, so a slow read and a slow write can overlap.
+struct ring
+{
+    struct copy_job *job;
+    char *slot[RING_SLOTS];
+    size_t len[RING_SLOTS];
+    int count;      // filled slots waiting for the writer
+    int eof;        // reader is done; read_errno says why
+    int read_errno;
+    int stop;       // writer failed, reader should give up
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+static void *ring_reader(void *arg)
 {
-    if (ptr == NULL)
-        return;
-    void *original_ptr = *((void **)((uintptr_t)ptr - sizeof(void *)));
-    free(original_ptr);
+    struct ring *r = arg;
+    placement_pin_reader(r->job->pl);
+
+    for (int tail = 0;; tail = (tail + 1) % RING_SLOTS)
+    {
+        pthread_mutex_lock(&r->lock);
+        while (r->count == RING_SLOTS && !r->stop)
+            pthread_cond_wait(&r->changed, &r->lock);
+        int stop = r->stop;
+        pthread_mutex_unlock(&r->lock);
+        if (stop)
+            break;
+
+        ssize_t n;
+        do
+            n = read(r->job->fd_in, r->slot[tail], r->job->bufsize);
+        while (n == -1 && errno == EINTR);
+
+        pthread_mutex_lock(&r->lock);
+        if (n <= 0)
+        {
+            r->eof = 1;
+            r->read_errno = n == -1 ? errno : 0;
+        }
+        else
+        {
+            r->len[tail] = (size_t)n;
+            r->count++;
+        }
+        pthread_cond_broadcast(&r->changed);
+        pthread_mutex_unlock(&r->lock);
+        if (n <= 0)
+            break;
+    }
+    return NULL;
+}
+
+static int copy_threaded(struct copy_job *job, char *slots)
+{
+    struct ring r = {.job = job};
+    for (int i = 0; i < RING_SLOTS; i++)
+        r.slot[i] = slots + (size_t)i * job->bufsize;
+    pthread_mutex_init(&r.lock, NULL);
+    pthread_cond_init(&r.changed, NULL);
+
+    pthread_t reader;
+    int err = pthread_create(&reader, NULL, ring_reader, &r);
+    if (err != 0)
+    {
+        fprintf(stderr, "Warning: cannot start reader thread (%s), copying single-threaded\n", strerror(err));
+        return copy_single(job, slots);
+    }
+    job->threaded = 1;
+    placement_pin_writer(job->pl);
+
+    int ret = 0;
+    for (int head = 0;; head = (head + 1) % RING_SLOTS)
+    {
+        pthread_mutex_lock(&r.lock);
+        while (r.count == 0 && !r.eof)
+            pthread_cond_wait(&r.changed, &r.lock);
+        int drained = r.count == 0;
+        size_t len = r.len[head];
+        pthread_mutex_unlock(&r.lock);
+        if (drained)
+            break;
+
+        if (mycat_write_all(STDOUT_FILENO, r.slot[head], len) == -1)
+        {
+            perror("Error writing to stdout");
+            ret = -1;
+            pthread_mutex_lock(&r.lock);
+            r.stop = 1;
+            pthread_cond_broadcast(&r.changed);
+            pthread_mutex_unlock(&r.lock);
+            break;
+        }
+        copy_index_chunk(job, r.slot[head], len);
+        job->copied += len;
+
+        pthread_mutex_lock(&r.lock);
+        r.count--;
+        pthread_cond_broadcast(&r.changed);
+        pthread_mutex_unlock(&r.lock);
+    }
+
+    pthread_join(reader, NULL);
+    pthread_cond_destroy(&r.changed);
+    pthread_mutex_destroy(&r.lock);
+    if (ret == 0 && r.read_errno != 0)
+    {
+        errno = r.read_errno;
+        perror("Error reading from input file");
+        ret = -1;
+    }
+    return ret;
+}
+
+// --build-index: refresh the sidecar index, scanning only what it does not cover yet.
+static int build_index(int fd_in, const char *path, char *buf, size_t bufsize)
+{
+    struct stat st;
+    if (fstat(fd_in, &st) == -1)
+    {
+        perror("fstat failed");
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        fprintf(stderr, "Error: %s is not a regular file, cannot index it\n", path);
+        return -1;
+    }
+
+    char *idx_path = lineidx_path(path);
+    if (idx_path == NULL)
+    {
+        perror("malloc failed");
+        return -1;
+    }
+
+    struct lineidx idx;
+    enum lineidx_state state = LINEIDX_STALE;
+    if (lineidx_open(&idx, idx_path) == 0)
+    {
+        state = lineidx_check(&idx, fd_in, &st);
+        if (state == LINEIDX_STALE)
+            lineidx_free(&idx);
+    }
+    if (state == LINEIDX_STALE && lineidx_init(&idx, LINEIDX_DEFAULT_STRIDE) == -1)
+    {
+        free(idx_path);
+        return -1;
+    }
+
+    int ret = 0;
+    if (state != LINEIDX_FRESH)
+    {
+        ret = lineidx_extend(&idx, fd_in, buf, bufsize);
+        if (ret == 0)
+            ret = lineidx_save(&idx, idx_path, fd_in);
+    }
+    lineidx_free(&idx);
+    free(idx_path);
+    return ret;
+}
+
+static int parse_line_range(const char *arg, uint64_t *first, uint64_t *last)
+{
+    char *end;
+    errno = 0;
+    // strtoull would quietly wrap "-5" around to 2^64 - 5.
+    if (*arg == '-')
+        return -1;
+    *first = strtoull(arg, &end, 10);
+    if (end == arg)
+        return -1;
+    if (*end == ',')
+    {
+        const char *second = end + 1;
+        if (*second == '-')
+            return -1;
+        *last = strtoull(second, &end, 10);
+        if (end == second)
+            return -1;
+    }
+    else
+        *last = *first;
+    return (errno == 0 && *end == '\0' && *first >= 1 && *last >= *first) ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--index] <file>\n"
+            "       %s --build-index <file>\n"
+            "       %s --lines A[,B] <file>\n"
+            "       %s --tail N [--follow] <file>\n"
+            "       %s [--threaded] [--cpus R[,W]] [--numa auto|N] [--stats] [--explain|--dry-run] <file>\n"
+            "  --index        also write the line index <file>" LINEIDX_SUFFIX " during this pass\n"
+            "  --build-index  only create or extend the line index, print nothing\n"
+            "  --lines A,B    print lines A..B, seeking via the line index when it is valid\n"
+            "  --tail N       print the last N lines, reading backwards from the end\n"
+            "  --follow       with --tail, keep printing data appended to the file\n"
+            "  --threaded     overlap reads and writes with a reader thread\n"
+            "  --cpus R[,W]   pin the reader (and, with --threaded, writer) thread\n"
+            "  --numa auto|N  run on and allocate buffers from NUMA node N (auto: the input device's node)\n"
+            "  --stats        print throughput and the thread/buffer placement to stderr\n"
+            "  --explain      print which copy engine is used for this input/stdout pair and why\n"
+            "  --dry-run      like --explain, but copy nothing\n",
+            prog, prog, prog, prog, prog);
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    static const struct option long_options[] = {
+        {"index", no_argument, NULL, 'i'},
+        {"build-index", no_argument, NULL, 'b'},
+        {"lines", required_argument, NULL, 'n'},
+        {"tail", required_argument, NULL, 't'},
+        {"follow", no_argument, NULL, 'f'},
+        {"threaded", no_argument, NULL, 'T'},
+        {"cpus", required_argument, NULL, 'c'},
+        {"numa", required_argument, NULL, 'N'},
+        {"stats", no_argument, NULL, 's'},
+        {"explain", no_argument, NULL, 'e'},
+        {"dry-run", no_argument, NULL, 'd'},
+        {NULL, 0, NULL, 0},
+    };
+    int index_while_copying = 0;
+    int index_only = 0;
+    int lines_mode = 0;
+    int tail_mode = 0;
+    int follow = 0;
+    uint64_t first_line = 0, last_line = 0;
+    uint64_t tail_count = 0;
+    int threaded = 0;
+    int stats = 0;
+    int explain = 0;
+    int dry_run = 0;
+    struct placement pl;
+    placement_init(&pl);
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, NULL)) != -1)
     {
-        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+        switch (opt)
+        {
+        case 'i':
+            index_while_copying = 1;
+            break;
+        case 'b':
+            index_only = 1;
+            break;
+        case 'n':
+            if (parse_line_range(optarg, &first_line, &last_line) == -1)
+            {
+                fprintf(stderr, "Invalid line range '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            lines_mode = 1;
+            break;
+        case 't':
+        {
+            char *end;
+            errno = 0;
+            tail_count = strtoull(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || *optarg == '-')
+            {
+                fprintf(stderr, "Invalid line count '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            tail_mode = 1;
+            break;
+        }
+        case 'f':
+            follow = 1;
+            break;
+        case 'T':
+            threaded = 1;
+            break;
+        case 'c':
+            if (placement_parse_cpus(&pl, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid CPU list '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'N':
+            if (placement_parse_numa(&pl, optarg) == -1)
+            {
+                fprintf(stderr, "Invalid NUMA node '%s'\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 's':
+            stats = 1;
+            break;
+        case 'e':
+            explain = 1;
+            break;
+        case 'd':
+            dry_run = 1;
+            break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    int copy_options = threaded || stats || explain || dry_run || placement_active(&pl);
+    if (optind != argc - 1 || index_while_copying + index_only + lines_mode + tail_mode > 1 || (follow && !tail_mode) ||
+        (copy_options && (index_only || lines_mode || tail_mode)) || (dry_run && (threaded || index_while_copying)))
+    {
+        usage(argv[0]);
         exit(EXIT_FAILURE);
     }
+    if (!threaded && pl.reader_cpu != pl.writer_cpu)
+    {
+        fprintf(stderr, "Error: --cpus R,W needs --threaded; without it one thread reads and writes\n");
+        exit(EXIT_FAILURE);
+    }
+    const char *path = argv[optind];
 
-    int fd_in = open(argv[1], O_RDONLY);
+    int fd_in = open(path, O_RDONLY);
     if (fd_in == -1)
     {
         perror("Error opening input file");
@@ -91,16 +604,17 @@ int main(int argc, char *argv[])
     // --- Add posix_fadvise call ---
     // Advise the kernel that we will be reading this file sequentially.
     // offset = 0, len = 0 means advise for the entire file.
-    int ret_fadvise = posix_fadvise(fd_in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    // --tail reads a few blocks backwards from EOF, where readahead would only waste I/O.
+    int ret_fadvise = posix_fadvise(fd_in, 0, 0, tail_mode ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
     if (ret_fadvise != 0)
     {
         // fadvise failure is not critical for cat's core functionality,
         // so we just print a warning and continue.
-        fprintf(stderr, "Warning: posix_fadvise (SEQUENTIAL) failed: %s\n", strerror(ret_fadvise));
+        fprintf(stderr, "Warning: posix_fadvise (%s) failed: %s\n", tail_mode ? "RANDOM" : "SEQUENTIAL", strerror(ret_fadvise));
     }
     // --- End of posix_fadvise call ---
 
-    long buffer_size = determine_io_blocksize_mycat6(fd_in);
+    long buffer_size = mycat_io_blocksize(fd_in);
 
     long system_page_size = sysconf(_SC_PAGESIZE);
     if (system_page_size == -1)
@@ -114,39 +628,93 @@ int main(int argc, char *argv[])
         system_page_size = 4096;
     }
 
-    char *buffer = (char *)align_alloc(buffer_size, system_page_size);
+    // --threaded keeps RING_SLOTS buffers in one page-aligned block.
+    size_t alloc_size = (size_t)buffer_size * (threaded ? RING_SLOTS : 1);
+    char *buffer = (char *)align_alloc(alloc_size, system_page_size);
     if (buffer == NULL)
     {
         close(fd_in);
         exit(EXIT_FAILURE);
     }
+    if (copy_options)
+    {
+        placement_resolve(&pl, fd_in);
+        placement_bind_buffer(&pl, buffer, alloc_size); // before anything touches the pages
+    }
 
-    ssize_t bytes_read;
-    ssize_t bytes_written_total;
-    ssize_t bytes_written_one;
+    if (tail_mode)
+    {
+        uint64_t end = 0;
+        int ret = tail_lines(fd_in, tail_count, &end, buffer, buffer_size);
+        if (ret == 0 && follow)
+            ret = follow_file(fd_in, path, end, buffer, buffer_size);
+        align_free(buffer);
+        close(fd_in);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (lines_mode || index_only)
+    {
+        int ret = lines_mode ? serve_lines(fd_in, path, first_line, last_line, buffer, buffer_size)
+                             : build_index(fd_in, path, buffer, buffer_size);
+        align_free(buffer);
+        close(fd_in);
+        return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-    while ((bytes_read = read(fd_in, buffer, buffer_size)) > 0)
+    // --index: the newline scan piggybacks on the buffers we copy anyway.
+    struct lineidx idx;
+    struct stat in_stat;
+    if (index_while_copying)
     {
-        bytes_written_total = 0;
-        while (bytes_written_total < bytes_read)
+        if (fstat(fd_in, &in_stat) == -1 || !S_ISREG(in_stat.st_mode))
         {
-            bytes_written_one = write(STDOUT_FILENO, buffer + bytes_written_total, bytes_read - bytes_written_total);
-            if (bytes_written_one == -1)
-            {
-                if (errno == EINTR)
-                    continue;
-                perror("Error writing to stdout");
-                align_free(buffer);
-                close(fd_in);
-                exit(EXIT_FAILURE);
-            }
-            bytes_written_total += bytes_written_one;
+            fprintf(stderr, "Warning: %s is not a regular file, not indexing it\n", path);
+            index_while_copying = 0;
+        }
+        else if (lineidx_init(&idx, LINEIDX_DEFAULT_STRIDE) == -1)
+        {
+            index_while_copying = 0;
         }
     }
 
-    if (bytes_read == -1)
+    struct copy_job job = {
+        .fd_in = fd_in,
+        .bufsize = (size_t)buffer_size,
+        .idx = index_while_copying ? &idx : NULL,
+        .pl = &pl,
+        .explain = explain,
+        .dry_run = dry_run,
+    };
+    if (threaded && explain)
+        fprintf(stderr, "copy plan: --threaded always uses read/write through %d buffers of %ld KB\n", RING_SLOTS,
+                buffer_size / 1024);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int ret = threaded ? copy_threaded(&job, buffer) : copy_single(&job, buffer);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (job.idx != NULL)
     {
-        perror("Error reading from input file");
+        if (ret == 0)
+        {
+            char *idx_path = lineidx_path(path);
+            if (idx_path != NULL)
+                lineidx_save(job.idx, idx_path, fd_in); // failure only costs the next --lines a full scan
+            free(idx_path);
+        }
+        lineidx_free(job.idx);
+    }
+
+    if (stats)
+    {
+        // Only read/write goes through our (possibly mbind'ed) buffers.
+        int buffers_used = job.threaded || job.engine == COPY_ENGINE_READ_WRITE;
+        double seconds = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+        fprintf(stderr, "stats: %llu bytes in %.3f s (%.2f GB/s), %s, %ld KB buffers\n", (unsigned long long)job.copied,
+                seconds, seconds > 0 ? (double)job.copied / seconds / (1024.0 * 1024 * 1024) : 0.0,
+                job.threaded ? "threaded reader/writer" : copy_engine_name(job.engine), buffer_size / 1024);
+        placement_report(stderr, &pl, job.threaded, buffers_used);
     }
 
     // It can be beneficial to advise POSIX_FADV_DONTNEED after reading,
@@ -158,9 +726,9 @@ int main(int argc, char *argv[])
     if (close(fd_in) == -1)
     {
         perror("Error closing input file");
-        if (bytes_read != -1)
+        if (ret != -1)
             exit(EXIT_FAILURE);
     }
 
-    return (bytes_read == -1) ? EXIT_FAILURE : EXIT_SUCCESS;
+    return (ret == -1) ? EXIT_FAILURE : EXIT_SUCCESS;
 }
\ No newline at end of file
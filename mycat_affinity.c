@@ -0,0 +1,227 @@
+// mycat_affinity.c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h> // major, minor
+#include <sys/syscall.h>
+#include <linux/mempolicy.h> // MPOL_PREFERRED; raw syscall, so no libnuma dependency
+#include "mycat_affinity.h"
+
+void placement_init(struct placement *pl)
+{
+    memset(pl, 0, sizeof(*pl));
+    pl->reader_cpu = -1;
+    pl->writer_cpu = -1;
+    pl->numa_node = -1;
+    pl->device_node = -1;
+    pl->buffer_node = -1;
+}
+
+int placement_parse_cpus(struct placement *pl, const char *arg)
+{
+    char *end;
+    long reader = strtol(arg, &end, 10);
+    long writer = reader;
+    if (*end == ',')
+        writer = strtol(end + 1, &end, 10);
+    if (end == arg || *end != '\0' || reader < 0 || writer < 0 || reader >= CPU_SETSIZE || writer >= CPU_SETSIZE)
+        return -1;
+    pl->reader_cpu = (int)reader;
+    pl->writer_cpu = (int)writer;
+    return 0;
+}
+
+int placement_parse_numa(struct placement *pl, const char *arg)
+{
+    if (strcmp(arg, "auto") == 0)
+    {
+        pl->numa_node = PLACEMENT_AUTO_NODE;
+        return 0;
+    }
+    char *end;
+    long node = strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || node < 0 || node >= 1024)
+        return -1;
+    pl->numa_node = (int)node;
+    return 0;
+}
+
+// Walks up from /sys/dev/block/MAJ:MIN (partition -> disk -> controller -> PCI
+// device) until some level reports a numa_node.
+static int device_numa_node(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -1;
+    dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+
+    char link[64];
+    snprintf(link, sizeof(link), "/sys/dev/block/%u:%u", major(dev), minor(dev));
+    char *dir = realpath(link, NULL);
+    if (dir == NULL)
+        return -1; // e.g. tmpfs or overlayfs: no backing block device
+
+    int node = -1;
+    while (strncmp(dir, "/sys/devices/", 13) == 0)
+    {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/numa_node", dir);
+        FILE *f = fopen(path, "r");
+        if (f != NULL)
+        {
+            if (fscanf(f, "%d", &node) != 1)
+                node = -1;
+            fclose(f);
+            break;
+        }
+        *strrchr(dir, '/') = '\0';
+    }
+    free(dir);
+    return node;
+}
+
+// Parses /sys/devices/system/node/nodeN/cpulist ("0-7,16-23").
+static int node_cpus(int node, cpu_set_t *set)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+        return -1;
+
+    CPU_ZERO(set);
+    int first, last, count = 0;
+    while (fscanf(f, "%d", &first) == 1)
+    {
+        last = first;
+        int c = fgetc(f);
+        if (c == '-')
+        {
+            if (fscanf(f, "%d", &last) != 1)
+                break;
+            c = fgetc(f);
+        }
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++, count++)
+            CPU_SET(cpu, set);
+        if (c != ',')
+            break;
+    }
+    fclose(f);
+    return count > 0 ? 0 : -1;
+}
+
+void placement_resolve(struct placement *pl, int fd_in)
+{
+    pl->device_node = device_numa_node(fd_in);
+    if (pl->numa_node == PLACEMENT_AUTO_NODE)
+    {
+        pl->numa_node = pl->device_node;
+        if (pl->numa_node < 0)
+            fprintf(stderr, "Warning: NUMA node of the input device is unknown, not binding\n");
+    }
+    if (pl->numa_node >= 0)
+    {
+        pl->node_cpus_set = node_cpus(pl->numa_node, &pl->node_cpus) == 0;
+        if (!pl->node_cpus_set)
+            fprintf(stderr, "Warning: cannot read the CPU list of NUMA node %d\n", pl->numa_node);
+    }
+}
+
+int placement_active(const struct placement *pl)
+{
+    return pl->reader_cpu >= 0 || pl->writer_cpu >= 0 || pl->numa_node != -1;
+}
+
+// An explicit CPU wins over the node's CPU set.
+static int pin_self(const struct placement *pl, int cpu, const char *role, int *failed)
+{
+    cpu_set_t set;
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+    }
+    else if (pl->node_cpus_set)
+        set = pl->node_cpus;
+    else
+        return 0;
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+        fprintf(stderr, "Warning: cannot pin %s thread: %s\n", role, strerror(err));
+        *failed = 1;
+        return -1;
+    }
+    return 0;
+}
+
+int placement_pin_reader(struct placement *pl)
+{
+    return pin_self(pl, pl->reader_cpu, "reader", &pl->reader_failed);
+}
+
+int placement_pin_writer(struct placement *pl)
+{
+    return pin_self(pl, pl->writer_cpu, "writer", &pl->writer_failed);
+}
+
+int placement_bind_buffer(struct placement *pl, void *buf, size_t len)
+{
+    if (pl->numa_node < 0)
+        return 0;
+
+    unsigned long nodemask[1024 / (8 * sizeof(unsigned long))] = {0};
+    nodemask[pl->numa_node / (8 * sizeof(unsigned long))] |= 1UL << (pl->numa_node % (8 * sizeof(unsigned long)));
+
+    // MPOL_PREFERRED rather than MPOL_BIND: a full node degrades to remote
+    // memory instead of failing the copy.
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t rounded = (len + (size_t)page_size - 1) & ~((size_t)page_size - 1);
+    if (syscall(SYS_mbind, buf, rounded, MPOL_PREFERRED, nodemask, sizeof(nodemask) * 8, 0) == -1)
+    {
+        fprintf(stderr, "Warning: mbind to NUMA node %d failed: %s\n", pl->numa_node, strerror(errno));
+        return -1;
+    }
+    pl->buffer_node = pl->numa_node;
+    return 0;
+}
+
+static void report_cpu(FILE *out, const struct placement *pl, int cpu, int failed)
+{
+    if (failed)
+        fprintf(out, "unpinned (pinning failed)");
+    else if (cpu >= 0)
+        fprintf(out, "cpu %d", cpu);
+    else if (pl->node_cpus_set)
+        fprintf(out, "node %d cpus", pl->numa_node);
+    else
+        fprintf(out, "unpinned");
+}
+
+void placement_report(FILE *out, const struct placement *pl, int threaded, int buffers_used)
+{
+    fprintf(out, "placement: device node ");
+    if (pl->device_node >= 0)
+        fprintf(out, "%d", pl->device_node);
+    else
+        fprintf(out, "unknown");
+    fprintf(out, ", reader ");
+    report_cpu(out, pl, pl->reader_cpu, pl->reader_failed);
+    fprintf(out, ", writer ");
+    if (threaded)
+        report_cpu(out, pl, pl->writer_cpu, pl->writer_failed);
+    else
+        fprintf(out, "same thread as reader");
+    if (pl->buffer_node >= 0 && !buffers_used)
+        fprintf(out, ", buffers node %d (mbind, unused by the zero-copy engine)\n", pl->buffer_node);
+    else if (pl->buffer_node >= 0)
+        fprintf(out, ", buffers node %d (mbind)\n", pl->buffer_node);
+    else
+        fprintf(out, ", buffers default policy\n");
+}
@@ -0,0 +1,55 @@
+// mycat_affinity.h
+// 线程与缓冲区的 CPU / NUMA 放置：把读写线程绑定到指定 CPU，或者自动绑定到
+// 输入文件所在块设备的 NUMA 节点（从 sysfs 读取），并用 mbind 把缓冲区放在同一节点上。
+#ifndef MYCAT_AFFINITY_H
+#define MYCAT_AFFINITY_H
+
+// cpu_set_t needs _GNU_SOURCE defined before the first system header.
+#include <stdio.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define PLACEMENT_AUTO_NODE -2 // --numa auto: use the input device's node
+
+struct placement
+{
+    int reader_cpu;    // -1: not pinned
+    int writer_cpu;    // -1: not pinned
+    int numa_node;     // requested node, PLACEMENT_AUTO_NODE, or -1 for none
+    int device_node;   // input device's node from sysfs, -1 if unknown
+    int buffer_node;   // node the buffers were bound to, -1 if not bound
+    int node_cpus_set; // node_cpus holds the CPUs of numa_node
+    int reader_failed; // pthread_setaffinity_np refused, set by the pinning thread
+    int writer_failed;
+    cpu_set_t node_cpus;
+};
+
+void placement_init(struct placement *pl);
+
+// Parses "R" or "R,W" for --cpus.
+int placement_parse_cpus(struct placement *pl, const char *arg);
+
+// Parses "auto" or a node number for --numa.
+int placement_parse_numa(struct placement *pl, const char *arg);
+
+// Resolves --numa auto against fd_in's device and loads the node's CPU list.
+// Unknown topology is not an error: the placement just stays unpinned.
+void placement_resolve(struct placement *pl, int fd_in);
+
+// Whether any CPU pinning or memory binding was requested.
+int placement_active(const struct placement *pl);
+
+// Pins the calling thread for its role. Returns -1 on failure (with a warning).
+int placement_pin_reader(struct placement *pl);
+int placement_pin_writer(struct placement *pl);
+
+// Binds the pages of a page-aligned buffer (as returned by align_alloc) to the
+// chosen node. Must run before the buffer is first touched.
+int placement_bind_buffer(struct placement *pl, void *buf, size_t len);
+
+// Without threaded the reader thread also writes, so no writer CPU is shown.
+// buffers_used is 0 when a zero-copy engine bypassed the bound buffers.
+void placement_report(FILE *out, const struct placement *pl, int threaded, int buffers_used);
+
+#endif
@@ -0,0 +1,420 @@
+// mycat_copy.c
+#define _GNU_SOURCE // splice, copy_file_range
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/vfs.h> // fstatfs
+#include <sys/sendfile.h>
+#include "mycat_copy.h"
+
+#define COPY_MAX_CHUNK (1UL << 30) // per zero-copy syscall, well below any ssize_t limit
+
+// ---- shared helpers (formerly duplicated in every mycatN.c) -----------------
+
+void *align_alloc(size_t size, size_t alignment)
+{
+    if (alignment == 0)
+        alignment = 1;
+    if ((alignment & (alignment - 1)) != 0 && alignment != 1)
+    {
+        fprintf(stderr, "Warning: Alignment %zu is not a power of two. Using page size.\n", alignment);
+        alignment = sysconf(_SC_PAGESIZE);
+        if (alignment <= 0 || (alignment & (alignment - 1)) != 0)
+            alignment = 4096;
+    }
+
+    void *original_ptr;
+    // We need space for the original pointer + the requested size + potential alignment padding
+    size_t total_size = size + alignment - 1 + sizeof(void *);
+    original_ptr = malloc(total_size);
+    if (original_ptr == NULL)
+    {
+        perror("malloc failed in align_alloc");
+        return NULL;
+    }
+
+    // Leave room for the original pointer, then round up to the alignment boundary.
+    uintptr_t aligned_addr_val = ((uintptr_t)original_ptr + sizeof(void *) + alignment - 1) & ~(alignment - 1);
+    void *aligned_ptr = (void *)aligned_addr_val;
+
+    // Store the original pointer just before the aligned block
+    *((void **)((uintptr_t)aligned_ptr - sizeof(void *))) = original_ptr;
+    return aligned_ptr;
+}
+
+void align_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    void *original_ptr = *((void **)((uintptr_t)ptr - sizeof(void *)));
+    free(original_ptr);
+}
+
+long mycat_io_blocksize(int fd)
+{
+    struct stat file_stat;
+    blksize_t fs_blk_size = 0;
+
+    if (fstat(fd, &file_stat) == 0)
+    {
+        fs_blk_size = file_stat.st_blksize;
+        if (fs_blk_size <= 0 || (fs_blk_size & (fs_blk_size - 1)) != 0)
+        {                    // Not positive or not power of 2
+            fs_blk_size = 0; // Treat as invalid for comparison
+        }
+    }
+
+    long chosen_buffer_size = OPTIMAL_BUFFER_SIZE;
+    if (fs_blk_size > 0 && (long)fs_blk_size > chosen_buffer_size)
+    {
+        chosen_buffer_size = (long)fs_blk_size;
+    }
+    return chosen_buffer_size;
+}
+
+int mycat_write_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// ---- classification ---------------------------------------------------------
+
+const char *copy_engine_name(enum copy_engine engine)
+{
+    static const char *const names[] = {"copy_file_range", "splice", "sendfile", "read/write"};
+    return engine < COPY_ENGINE_COUNT ? names[engine] : "?";
+}
+
+const char *fd_kind_name(enum fd_kind kind)
+{
+    static const char *const names[] = {"regular file", "pipe", "socket", "tty", "block device", "character device", "other"};
+    return names[kind];
+}
+
+static const struct
+{
+    unsigned long magic;
+    const char *name;
+    int pseudo;
+} known_filesystems[] = {
+    {0xEF53, "ext2/3/4", 0},
+    {0x58465342, "xfs", 0},
+    {0x9123683E, "btrfs", 0},
+    {0xF2F52010, "f2fs", 0},
+    {0x2FC12FC1, "zfs", 0},
+    {0x01021994, "tmpfs", 0},
+    {0x794C7630, "overlayfs", 0},
+    {0x6969, "nfs", 0},
+    {0xFF534D42, "cifs", 0},
+    {0x65735546, "fuse", 0},
+    {0x9FA0, "proc", 1},
+    {0x62656572, "sysfs", 1},
+    {0x64626720, "debugfs", 1},
+};
+
+static int classify_fd(int fd, struct fd_info *info)
+{
+    memset(info, 0, sizeof(*info));
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -1;
+
+    if (S_ISREG(st.st_mode))
+        info->kind = FD_KIND_REGULAR;
+    else if (S_ISFIFO(st.st_mode))
+        info->kind = FD_KIND_PIPE;
+    else if (S_ISSOCK(st.st_mode))
+        info->kind = FD_KIND_SOCKET;
+    else if (S_ISBLK(st.st_mode))
+        info->kind = FD_KIND_BLOCK;
+    else if (S_ISCHR(st.st_mode))
+        info->kind = isatty(fd) ? FD_KIND_TTY : FD_KIND_CHAR;
+    else
+        info->kind = FD_KIND_OTHER;
+
+    int flags = fcntl(fd, F_GETFL);
+    info->append = flags != -1 && (flags & O_APPEND);
+
+    struct statfs sfs;
+    if ((info->kind == FD_KIND_REGULAR || info->kind == FD_KIND_BLOCK) && fstatfs(fd, &sfs) == 0)
+    {
+        info->fs = "unknown fs";
+        for (size_t i = 0; i < sizeof(known_filesystems) / sizeof(known_filesystems[0]); i++)
+        {
+            if ((unsigned long)sfs.f_type == known_filesystems[i].magic)
+            {
+                info->fs = known_filesystems[i].name;
+                info->pseudo_fs = known_filesystems[i].pseudo;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+int mycat_copy_plan(int fd_in, int fd_out, const struct copy_options *opts, struct copy_plan *plan)
+{
+    memset(plan, 0, sizeof(*plan));
+    if (classify_fd(fd_in, &plan->in) == -1 || classify_fd(fd_out, &plan->out) == -1)
+        return -1;
+
+    const struct fd_info *in = &plan->in;
+    const struct fd_info *out = &plan->out;
+    int in_paged = (in->kind == FD_KIND_REGULAR || in->kind == FD_KIND_BLOCK) && !in->pseudo_fs;
+    int n = 0;
+
+    if (opts != NULL && opts->on_chunk != NULL)
+        plan->reason = "a chunk callback needs every byte in user space";
+    else if (in->pseudo_fs)
+        plan->reason = "pseudo filesystem input generates data on read(), zero-copy paths may see nothing";
+    else if (out->append && out->kind == FD_KIND_REGULAR)
+        plan->reason = "output is O_APPEND, which copy_file_range, splice and sendfile refuse";
+    else if (in->kind == FD_KIND_REGULAR && out->kind == FD_KIND_REGULAR)
+    {
+        plan->reason = "file to file: copy_file_range stays in the kernel and can reflink or copy server-side";
+        plan->engines[n++] = COPY_ENGINE_COPY_FILE_RANGE;
+        plan->engines[n++] = COPY_ENGINE_SENDFILE;
+    }
+    else if (in->kind == FD_KIND_PIPE || out->kind == FD_KIND_PIPE)
+    {
+        plan->reason = "one side is a pipe: splice moves page references without a user-space copy";
+        plan->engines[n++] = COPY_ENGINE_SPLICE;
+        if (in_paged)
+            plan->engines[n++] = COPY_ENGINE_SENDFILE;
+    }
+    else if (in_paged)
+    {
+        plan->reason = "page-cache input: sendfile hands the pages straight to the output";
+        plan->engines[n++] = COPY_ENGINE_SENDFILE;
+    }
+    else
+        plan->reason = "no zero-copy path between these fd types";
+
+    plan->engines[n++] = COPY_ENGINE_READ_WRITE;
+    plan->n_engines = n;
+    return 0;
+}
+
+static void explain_fd(FILE *out, const struct fd_info *info)
+{
+    fprintf(out, "%s", fd_kind_name(info->kind));
+    if (info->fs != NULL)
+        fprintf(out, " (%s)", info->fs);
+    if (info->append)
+        fprintf(out, " [append]");
+}
+
+void mycat_copy_explain(FILE *out, const struct copy_plan *plan)
+{
+    fprintf(out, "copy plan: in=");
+    explain_fd(out, &plan->in);
+    fprintf(out, " out=");
+    explain_fd(out, &plan->out);
+    fprintf(out, "\n  engines: ");
+    for (int i = 0; i < plan->n_engines; i++)
+        fprintf(out, "%s%s", i ? " -> " : "", copy_engine_name(plan->engines[i]));
+    fprintf(out, "\n  why: %s\n", plan->reason);
+}
+
+// ---- engines ----------------------------------------------------------------
+
+struct copy_run
+{
+    int fd_in, fd_out;
+    const struct copy_options *opts;
+    size_t bufsize;
+    char *buf; // allocated on first use by read/write
+    int own_buf;
+    int out_append;
+    uint64_t remaining; // UINT64_MAX when copying to EOF
+    uint64_t bytes;
+    int refused_errno; // why the last engine gave up, 0: its first call returned 0
+};
+
+enum engine_result
+{
+    ENGINE_DONE,
+    ENGINE_FAILED,
+    ENGINE_UNSUPPORTED // refused before or while copying; the next engine continues from here
+};
+
+// errnos with which the kernel says "not for this fd pair" rather than "I/O failed".
+// EBADF is only such a case for copy_file_range into an O_APPEND output
+// (sendfile and splice use EINVAL there); otherwise the fd really is closed
+// or has the wrong mode.
+static int is_unsupported(enum copy_engine engine, const struct copy_run *run, int err)
+{
+    if (err == EBADF)
+        return run->out_append && engine == COPY_ENGINE_COPY_FILE_RANGE;
+    return err == EINVAL || err == ENOSYS || err == EXDEV || err == EOPNOTSUPP;
+}
+
+static size_t next_chunk(const struct copy_run *run)
+{
+    return run->remaining < COPY_MAX_CHUNK ? (size_t)run->remaining : COPY_MAX_CHUNK;
+}
+
+// The three zero-copy engines differ only in the syscall.
+static ssize_t zero_copy_step(enum copy_engine engine, struct copy_run *run, size_t chunk)
+{
+    switch (engine)
+    {
+    case COPY_ENGINE_COPY_FILE_RANGE:
+        return copy_file_range(run->fd_in, NULL, run->fd_out, NULL, chunk, 0);
+    case COPY_ENGINE_SPLICE:
+        return splice(run->fd_in, NULL, run->fd_out, NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+    case COPY_ENGINE_SENDFILE:
+        return sendfile(run->fd_out, run->fd_in, NULL, chunk);
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+static enum engine_result run_zero_copy(enum copy_engine engine, struct copy_run *run)
+{
+    int first = 1;
+    while (run->remaining > 0)
+    {
+        ssize_t n = zero_copy_step(engine, run, next_chunk(run));
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            if (is_unsupported(engine, run, errno))
+            {
+                run->refused_errno = errno;
+                return ENGINE_UNSUPPORTED;
+            }
+            perror(copy_engine_name(engine));
+            return ENGINE_FAILED;
+        }
+        if (n == 0)
+        {
+            // Nothing at all on the first call may be a file the engine cannot
+            // see into (e.g. an old kernel and a special file): let read() decide.
+            run->refused_errno = 0;
+            return first ? ENGINE_UNSUPPORTED : ENGINE_DONE;
+        }
+        first = 0;
+        run->bytes += (uint64_t)n;
+        run->remaining -= (uint64_t)n;
+    }
+    return ENGINE_DONE;
+}
+
+static enum engine_result run_read_write(struct copy_run *run)
+{
+    if (run->buf == NULL)
+    {
+        run->buf = align_alloc(run->bufsize, (size_t)sysconf(_SC_PAGESIZE));
+        if (run->buf == NULL)
+            return ENGINE_FAILED;
+        run->own_buf = 1;
+    }
+
+    while (run->remaining > 0)
+    {
+        size_t want = run->remaining < run->bufsize ? (size_t)run->remaining : run->bufsize;
+        ssize_t n = read(run->fd_in, run->buf, want);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading from input file");
+            return ENGINE_FAILED;
+        }
+        if (n == 0)
+            break;
+        if (mycat_write_all(run->fd_out, run->buf, (size_t)n) == -1)
+        {
+            perror("Error writing to output");
+            return ENGINE_FAILED;
+        }
+        if (run->opts->on_chunk != NULL)
+            run->opts->on_chunk(run->opts->on_chunk_ctx, run->buf, (size_t)n);
+        run->bytes += (uint64_t)n;
+        run->remaining -= (uint64_t)n;
+    }
+    return ENGINE_DONE;
+}
+
+int mycat_copy(int fd_in, int fd_out, const struct copy_options *opts, struct copy_stats *stats)
+{
+    static const struct copy_options defaults = {0};
+    if (opts == NULL)
+        opts = &defaults;
+
+    struct copy_plan plan;
+    if (mycat_copy_plan(fd_in, fd_out, opts, &plan) == -1)
+    {
+        perror("fstat failed while planning copy");
+        return -1;
+    }
+    if (opts->explain || opts->dry_run)
+        mycat_copy_explain(stderr, &plan);
+    if (opts->dry_run)
+        return 0;
+
+    struct copy_run run = {
+        .fd_in = fd_in,
+        .fd_out = fd_out,
+        .opts = opts,
+        .bufsize = opts->bufsize ? opts->bufsize : (size_t)mycat_io_blocksize(fd_in),
+        .buf = opts->buf,
+        .out_append = plan.out.append,
+        .remaining = opts->limit ? opts->limit : UINT64_MAX,
+    };
+
+    enum engine_result result = ENGINE_FAILED;
+    int i;
+    for (i = 0; i < plan.n_engines; i++)
+    {
+        result = plan.engines[i] == COPY_ENGINE_READ_WRITE ? run_read_write(&run)
+                                                           : run_zero_copy(plan.engines[i], &run);
+        if (result != ENGINE_UNSUPPORTED)
+            break;
+        if (!opts->explain)
+            continue;
+        if (run.refused_errno != 0)
+            fprintf(stderr, "  %s refused (%s), falling back\n", copy_engine_name(plan.engines[i]),
+                    strerror(run.refused_errno));
+        else
+            fprintf(stderr, "  %s returned no data on its first call (empty input or unsupported), trying %s\n",
+                    copy_engine_name(plan.engines[i]), copy_engine_name(plan.engines[i + 1]));
+    }
+    int saved_errno = errno;
+    enum copy_engine used = plan.engines[i]; // read/write never reports ENGINE_UNSUPPORTED
+
+    if (run.own_buf)
+        align_free(run.buf);
+    if (stats != NULL)
+    {
+        stats->bytes = run.bytes;
+        stats->engine = used;
+        stats->fallbacks = i;
+    }
+    if (opts->explain)
+        fprintf(stderr, "  %s %llu bytes with %s\n", result == ENGINE_DONE ? "copied" : "failed after",
+                (unsigned long long)run.bytes, copy_engine_name(used));
+
+    errno = saved_errno;
+    return result == ENGINE_DONE ? 0 : -1;
+}
@@ -0,0 +1,280 @@
+// mycat_lineidx.c
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "mycat_lineidx.h"
+#include "mycat_nl.h"
+#include "mycat_copy.h"
+
+#define LINEIDX_TAIL_BYTES 4096
+
+char *lineidx_path(const char *src_path)
+{
+    size_t len = strlen(src_path);
+    char *path = malloc(len + sizeof(LINEIDX_SUFFIX));
+    if (path == NULL)
+        return NULL;
+    memcpy(path, src_path, len);
+    memcpy(path + len, LINEIDX_SUFFIX, sizeof(LINEIDX_SUFFIX));
+    return path;
+}
+
+static int lineidx_reserve(struct lineidx *idx, size_t want)
+{
+    if (idx->capacity >= want)
+        return 0;
+
+    size_t new_capacity = idx->capacity ? idx->capacity : 64;
+    while (new_capacity < want)
+        new_capacity *= 2;
+
+    // A mapped index is read-only: move the offsets to the heap before growing.
+    uint64_t *grown = idx->capacity ? realloc(idx->offsets, new_capacity * sizeof(uint64_t))
+                                    : malloc(new_capacity * sizeof(uint64_t));
+    if (grown == NULL)
+    {
+        perror("Error growing line index");
+        return -1;
+    }
+    if (idx->capacity == 0 && idx->hdr.n_offsets > 0)
+        memcpy(grown, idx->offsets, idx->hdr.n_offsets * sizeof(uint64_t));
+    idx->offsets = grown;
+    idx->capacity = new_capacity;
+    return 0;
+}
+
+int lineidx_init(struct lineidx *idx, uint32_t stride)
+{
+    memset(idx, 0, sizeof(*idx));
+    memcpy(idx->hdr.magic, LINEIDX_MAGIC, sizeof(idx->hdr.magic));
+    idx->hdr.version = LINEIDX_VERSION;
+    idx->hdr.stride = stride ? stride : LINEIDX_DEFAULT_STRIDE;
+    if (lineidx_reserve(idx, 1) == -1)
+        return -1;
+    idx->offsets[0] = 0; // line 1 starts at byte 0
+    idx->hdr.n_offsets = 1;
+    return 0;
+}
+
+int lineidx_open(struct lineidx *idx, const char *idx_path)
+{
+    memset(idx, 0, sizeof(*idx));
+
+    int fd = open(idx_path, O_RDONLY);
+    if (fd == -1)
+        return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct lineidx_header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    const struct lineidx_header *hdr = map;
+    if (memcmp(hdr->magic, LINEIDX_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != LINEIDX_VERSION ||
+        hdr->stride == 0 || hdr->n_offsets == 0 ||
+        hdr->n_offsets > ((size_t)st.st_size - sizeof(*hdr)) / sizeof(uint64_t))
+    {
+        fprintf(stderr, "Warning: ignoring malformed line index %s\n", idx_path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    idx->hdr = *hdr;
+    idx->offsets = (uint64_t *)((char *)map + sizeof(*hdr));
+    idx->map = map;
+    idx->map_len = (size_t)st.st_size;
+    return 0;
+}
+
+void lineidx_free(struct lineidx *idx)
+{
+    if (idx->capacity)
+        free(idx->offsets);
+    if (idx->map)
+        munmap(idx->map, idx->map_len);
+    memset(idx, 0, sizeof(*idx));
+}
+
+int lineidx_feed(struct lineidx *idx, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        // offsets[n_offsets] will be the byte right after newline number n_offsets * stride.
+        size_t wanted = idx->hdr.n_offsets * idx->hdr.stride - idx->hdr.newlines;
+        size_t remaining = wanted;
+        ssize_t pos = nl_find_nth(buf, len, &remaining);
+        idx->hdr.newlines += wanted - remaining;
+        if (pos == -1)
+        {
+            idx->hdr.src_size += len;
+            return 0;
+        }
+
+        if (lineidx_reserve(idx, idx->hdr.n_offsets + 1) == -1)
+            return -1;
+        idx->offsets[idx->hdr.n_offsets++] = idx->hdr.src_size + (uint64_t)pos;
+        idx->hdr.src_size += (uint64_t)pos;
+        buf += pos;
+        len -= (size_t)pos;
+    }
+    return 0;
+}
+
+// FNV-1a over the (at most LINEIDX_TAIL_BYTES) bytes that end at `end`.
+static int lineidx_tail_hash(int src_fd, uint64_t end, uint64_t *hash)
+{
+    char tail[LINEIDX_TAIL_BYTES];
+    size_t want = end < sizeof(tail) ? (size_t)end : sizeof(tail);
+    size_t got = 0;
+
+    while (got < want)
+    {
+        ssize_t n = pread(src_fd, tail + got, want - got, (off_t)(end - want + got));
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (n == 0)
+            return -1; // source shrank under us
+        got += (size_t)n;
+    }
+
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < want; i++)
+    {
+        h ^= (unsigned char)tail[i];
+        h *= 0x100000001b3ULL;
+    }
+    *hash = h;
+    return 0;
+}
+
+enum lineidx_state lineidx_check(const struct lineidx *idx, int src_fd, const struct stat *src_st)
+{
+    if (idx->hdr.src_ino != (uint64_t)src_st->st_ino || (uint64_t)src_st->st_size < idx->hdr.src_size)
+        return LINEIDX_STALE;
+
+    if ((uint64_t)src_st->st_size == idx->hdr.src_size)
+    {
+        // Same size with a new mtime means it was rewritten in place.
+        if (idx->hdr.src_mtime_sec == (int64_t)src_st->st_mtim.tv_sec &&
+            idx->hdr.src_mtime_nsec == (int64_t)src_st->st_mtim.tv_nsec)
+            return LINEIDX_FRESH;
+        return LINEIDX_STALE;
+    }
+
+    // Larger: only trust it if the bytes we indexed last still end the same
+    // way, i.e. the log was appended to.
+    uint64_t hash;
+    if (lineidx_tail_hash(src_fd, idx->hdr.src_size, &hash) == -1 || hash != idx->hdr.tail_hash)
+        return LINEIDX_STALE;
+    return LINEIDX_GROWN;
+}
+
+int lineidx_extend(struct lineidx *idx, int src_fd, char *buf, size_t bufsize)
+{
+    for (;;)
+    {
+        ssize_t n = pread(src_fd, buf, bufsize, (off_t)idx->hdr.src_size);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("Error reading input file for line index");
+            return -1;
+        }
+        if (n == 0)
+            return 0;
+        if (lineidx_feed(idx, buf, (size_t)n) == -1)
+            return -1;
+    }
+}
+
+int lineidx_save(struct lineidx *idx, const char *idx_path, int src_fd)
+{
+    struct stat st;
+    if (fstat(src_fd, &st) == -1)
+    {
+        perror("fstat failed when saving line index");
+        return -1;
+    }
+    idx->hdr.src_ino = (uint64_t)st.st_ino;
+    idx->hdr.src_mtime_sec = (int64_t)st.st_mtim.tv_sec;
+    idx->hdr.src_mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+    if (lineidx_tail_hash(src_fd, idx->hdr.src_size, &idx->hdr.tail_hash) == -1)
+    {
+        fprintf(stderr, "Warning: input changed while indexing, line index not saved\n");
+        return -1;
+    }
+
+    // A private temp file per writer: concurrent --lines runs on a growing log
+    // may all save, and must not write into each other's file before the rename.
+    size_t tmp_len = strlen(idx_path) + sizeof(".XXXXXX");
+    char *tmp_path = malloc(tmp_len);
+    if (tmp_path == NULL)
+    {
+        perror("malloc failed in lineidx_save");
+        return -1;
+    }
+    snprintf(tmp_path, tmp_len, "%s.XXXXXX", idx_path);
+
+    int fd = mkstemp(tmp_path);
+    if (fd == -1)
+    {
+        fprintf(stderr, "Warning: cannot create line index %s: %s\n", tmp_path, strerror(errno));
+        free(tmp_path);
+        return -1;
+    }
+
+    int ret = 0;
+    if (fchmod(fd, 0644) == -1) // mkstemp creates it 0600
+    {
+        perror("Error setting line index permissions");
+        ret = -1;
+    }
+    if (ret == 0 && (mycat_write_all(fd, (const char *)&idx->hdr, sizeof(idx->hdr)) == -1 ||
+                     mycat_write_all(fd, (const char *)idx->offsets, idx->hdr.n_offsets * sizeof(uint64_t)) == -1))
+    {
+        perror("Error writing line index");
+        ret = -1;
+    }
+    if (close(fd) == -1 && ret == 0)
+    {
+        perror("Error closing line index");
+        ret = -1;
+    }
+    // Readers either see the old index or the complete new one.
+    if (ret == 0 && rename(tmp_path, idx_path) == -1)
+    {
+        perror("Error installing line index");
+        ret = -1;
+    }
+    if (ret == -1)
+        unlink(tmp_path);
+    free(tmp_path);
+    return ret;
+}
+
+void lineidx_seek_line(const struct lineidx *idx, uint64_t line, uint64_t *offset, uint64_t *skip)
+{
+    uint64_t before = line > 0 ? line - 1 : 0; // lines preceding `line`
+    uint64_t slot = before / idx->hdr.stride;
+    if (slot >= idx->hdr.n_offsets)
+        slot = idx->hdr.n_offsets - 1;
+    *offset = idx->offsets[slot];
+    *skip = before - slot * idx->hdr.stride;
+}
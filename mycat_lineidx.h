@@ -0,0 +1,79 @@
+// mycat_lineidx.h
+// 稀疏行偏移索引（sidecar 文件 "<file>.mcidx"）。
+//
+// 文件布局：struct lineidx_header，紧跟 n_offsets 个 uint64_t。
+// offsets[i] 是第 i * stride + 1 行（行号从 1 开始）的起始字节偏移，offsets[0] == 0。
+// 整个文件可以直接 mmap 只读使用；源文件只是追加增长时可以增量扩展。
+#ifndef MYCAT_LINEIDX_H
+#define MYCAT_LINEIDX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+
+#define LINEIDX_MAGIC "MCATIDX1"
+#define LINEIDX_VERSION 1
+#define LINEIDX_DEFAULT_STRIDE 4096 // one offset per 4096 lines
+#define LINEIDX_SUFFIX ".mcidx"
+
+struct lineidx_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t stride;
+    uint64_t src_size;       // bytes of the source covered by the index
+    int64_t src_mtime_sec;   // source mtime when the index was saved
+    int64_t src_mtime_nsec;
+    uint64_t src_ino;
+    uint64_t tail_hash;      // FNV-1a of the last bytes before src_size, see lineidx_check
+    uint64_t newlines;       // '\n' count in [0, src_size)
+    uint64_t n_offsets;
+};
+
+struct lineidx
+{
+    struct lineidx_header hdr;
+    uint64_t *offsets;
+    size_t capacity; // 0 while offsets still points into a read-only mapping
+    void *map;
+    size_t map_len;
+};
+
+// Result of lineidx_check.
+enum lineidx_state
+{
+    LINEIDX_FRESH, // matches the source size and mtime
+    LINEIDX_GROWN, // source was only appended to, lineidx_extend can catch up
+    LINEIDX_STALE  // unusable, rebuild from scratch
+};
+
+// Returns a malloc'd "<src_path>.mcidx", or NULL on allocation failure.
+char *lineidx_path(const char *src_path);
+
+// Starts an empty index over an empty prefix of the source.
+int lineidx_init(struct lineidx *idx, uint32_t stride);
+
+// Maps an existing index file. Returns -1 if it is missing or malformed.
+int lineidx_open(struct lineidx *idx, const char *idx_path);
+
+void lineidx_free(struct lineidx *idx);
+
+// Accounts for the next len bytes of the source (they follow hdr.src_size).
+int lineidx_feed(struct lineidx *idx, const char *buf, size_t len);
+
+// Same size needs the same mtime. A larger source counts as GROWN when the last
+// bytes indexed still hash the same: a heuristic that holds for append-only
+// files such as logs, but misses in-place edits before that tail.
+enum lineidx_state lineidx_check(const struct lineidx *idx, int src_fd, const struct stat *src_st);
+
+// Feeds the source from hdr.src_size to EOF, reading through buf.
+int lineidx_extend(struct lineidx *idx, int src_fd, char *buf, size_t bufsize);
+
+// Stamps the index with the source identity and atomically replaces idx_path.
+int lineidx_save(struct lineidx *idx, const char *idx_path, int src_fd);
+
+// Nearest indexed position at or before line (1-based): the byte offset to
+// seek to and how many lines still have to be skipped from there.
+void lineidx_seek_line(const struct lineidx *idx, uint64_t line, uint64_t *offset, uint64_t *skip);
+
+#endif
@@ -0,0 +1,117 @@
+// mycat_nl.c
+#define _GNU_SOURCE // memrchr
+#include <string.h> // memchr, memrchr
+#include "mycat_nl.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYCAT_NL_HAVE_AVX2 1
+#endif
+
+// Chunk used by nl_find_nth / nl_rfind_nth: count whole chunks with the fast kernel and
+// only walk the chunk that contains the wanted newline with memchr.
+#define NL_FIND_CHUNK 4096
+
+static size_t nl_count_scalar(const char *buf, size_t len)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < len; i++)
+        count += (buf[i] == '\n');
+    return count;
+}
+
+#ifdef MYCAT_NL_HAVE_AVX2
+// 每次比较 32 字节，比较结果 (0 / -1) 以字节为单位累加，
+// 最多累加 255 轮后用 _mm256_sad_epu8 横向求和，避免逐次 popcount。
+__attribute__((target("avx2"))) static size_t nl_count_avx2(const char *buf, size_t len)
+{
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 32 <= len)
+    {
+        __m256i acc = zero;
+        for (int round = 0; round < 255 && i + 32 <= len; round++, i += 32)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, newline));
+        }
+        __m256i sums = _mm256_sad_epu8(acc, zero);
+        count += (size_t)_mm256_extract_epi64(sums, 0) + (size_t)_mm256_extract_epi64(sums, 1) +
+                 (size_t)_mm256_extract_epi64(sums, 2) + (size_t)_mm256_extract_epi64(sums, 3);
+    }
+    return count + nl_count_scalar(buf + i, len - i);
+}
+#endif
+
+static size_t (*nl_count_impl)(const char *, size_t) = NULL;
+
+size_t nl_count(const char *buf, size_t len)
+{
+    if (nl_count_impl == NULL)
+    {
+        nl_count_impl = nl_count_scalar;
+#ifdef MYCAT_NL_HAVE_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            nl_count_impl = nl_count_avx2;
+#endif
+    }
+    return nl_count_impl(buf, len);
+}
+
+ssize_t nl_find_nth(const char *buf, size_t len, size_t *n)
+{
+    size_t pos = 0;
+    while (pos < len)
+    {
+        size_t chunk = len - pos < NL_FIND_CHUNK ? len - pos : NL_FIND_CHUNK;
+        size_t in_chunk = nl_count(buf + pos, chunk);
+        if (in_chunk < *n)
+        {
+            *n -= in_chunk;
+            pos += chunk;
+            continue;
+        }
+
+        // The wanted newline is inside this chunk.
+        const char *p = buf + pos;
+        const char *end = buf + pos + chunk;
+        for (;;)
+        {
+            const char *hit = memchr(p, '\n', (size_t)(end - p));
+            if (--*n == 0)
+                return (ssize_t)(hit + 1 - buf);
+            p = hit + 1;
+        }
+    }
+    return -1;
+}
+
+ssize_t nl_rfind_nth(const char *buf, size_t len, size_t *n)
+{
+    size_t end = len;
+    while (end > 0)
+    {
+        size_t chunk = end < NL_FIND_CHUNK ? end : NL_FIND_CHUNK;
+        size_t start = end - chunk;
+        size_t in_chunk = nl_count(buf + start, chunk);
+        if (in_chunk < *n)
+        {
+            *n -= in_chunk;
+            end = start;
+            continue;
+        }
+
+        const char *p = buf + end;
+        for (;;)
+        {
+            const char *hit = memrchr(buf + start, '\n', (size_t)(p - (buf + start)));
+            if (--*n == 0)
+                return (ssize_t)(hit - buf);
+            p = hit;
+        }
+    }
+    return -1;
+}
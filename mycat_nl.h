@@ -0,0 +1,24 @@
+// mycat_nl.h
+// 换行符扫描内核：统计 / 定位缓冲区中的 '\n'。
+// x86 上在运行时选择 AVX2 实现，其余平台使用可移植的标量实现。
+#ifndef MYCAT_NL_H
+#define MYCAT_NL_H
+
+#include <stddef.h>    // size_t
+#include <sys/types.h> // ssize_t
+
+// Number of '\n' bytes in buf[0, len).
+size_t nl_count(const char *buf, size_t len);
+
+// Finds the *n-th newline (*n >= 1) in buf[0, len).
+// Returns the offset just past it (the start of the following line).
+// *n is decremented by every newline consumed: it is 0 on success, and when
+// buf holds fewer than *n newlines, -1 is returned and *n is what is still
+// missing, so the caller can continue with the next block.
+ssize_t nl_find_nth(const char *buf, size_t len, size_t *n);
+
+// Same as nl_find_nth, but counts backwards from the end of buf (a
+// vectorised memrchr). Returns the offset of the newline itself.
+ssize_t nl_rfind_nth(const char *buf, size_t len, size_t *n);
+
+#endif